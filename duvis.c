@@ -6,68 +6,146 @@
  */ 
    
 /* xdu replacement with reasonable performance. */
- 
+
+/*
+ * This is the duvis library: all state for an analysis
+ * lives in its struct duvis, and errors are returned
+ * rather than fatal.
+ */
+
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-/* For command line variables */
-#include <getopt.h>
-
 #include "duvis.h"
+#include "duvis_int.h"
 #include "pathmem.h"
+#include "tasks.h"
+
+/* Returns 0 when out of memory. */
+struct duvis *duvis_new(int n_threads) {
+    struct duvis *d = calloc(1, sizeof(*d));
+    if (!d)
+        return 0;
+    if (n_threads < 1)
+        n_threads = 1;
+    d->n_threads = n_threads;
+    d->pool = duvis_task_pool_new(n_threads);
+    if (!d->pool) {
+        free(d);
+        return 0;
+    }
+    return d;
+}
+
+void duvis_free(struct duvis *d) {
+    if (!d)
+        return;
+    arena_free(&d->arena);
+    duvis_task_pool_free(d->pool);
+    free(d->entries);
+    free(d);
+}
+
+/*
+ * Record a read or build error and return its status. Only
+ * the first error sticks, since build tasks may fail
+ * concurrently.
+ */
+int duvis_fail(struct duvis *d, int status, const char *fmt, ...) {
+    int ok = DUVIS_OK;
+    if (!__atomic_compare_exchange_n(&d->status, &ok, status, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        return ok;
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(d->error, sizeof(d->error), fmt, args);
+    va_end(args);
+    return status;
+}
 
-#define IO_BUFFER_LENGTH (1024 * 1024)
+/*
+ * Report an output error and return its status. The
+ * analysis is still good, so the status doesn't stick.
+ */
+int duvis_report(struct duvis *d, int status, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(d->error, sizeof(d->error), fmt, args);
+    va_end(args);
+    return status;
+}
 
-int n_entries = 0;
-struct entry *entries = 0;
-struct entry *root_entry;
-int base_depth = 0;   /* Component length of initial prefix. */
+static int failed(struct duvis *d) {
+    return __atomic_load_n(&d->status, __ATOMIC_SEQ_CST) != DUVIS_OK;
+}
 
-static void read_entries(FILE *f, int zeroflag) {
+const char *duvis_error(struct duvis *d) {
+    return d->error;
+}
+
+int duvis_n_entries(struct duvis *d) {
+    return d->n_entries;
+}
+
+/* The root of the tree, or 0 until it is built. */
+struct duvis_entry *duvis_root(struct duvis *d) {
+    return d->root_entry;
+}
+
+int duvis_read(struct duvis *d, FILE *f, int zeroflag) {
+    if (d->status != DUVIS_OK)
+        return d->status;
+    if (d->entries)
+        return duvis_fail(d, DUVIS_ESTATE, "du input already read");
     int max_entries = 0;
     int line_number = 0;
     /* Loop reading lines from the du file and processing them. */
     while (1) {
         /* Get a buffer for the line data. */
-        char *path = path_alloc();
-        if (!path) {
-            perror("malloc(path)");
-            exit(1);
-        }
+        char *path = arena_alloc(&d->arena, DU_BUFFER_LENGTH);
+        if (!path)
+            return duvis_fail(d, DUVIS_ENOMEM, "malloc(path): out of memory");
         /* Read the next line. */
-        path[DU_BUFFER_LENGTH - 1] = '\0';
-        errno = 0;
         int nchars = path_get(path, DU_BUFFER_LENGTH, f, zeroflag);
         if (nchars == -1)
-            fprintf(stderr, "line %d: path buffer overrun\n",
-                    line_number + 1);
+            return duvis_fail(d, DUVIS_EFORMAT,
+                              "line %d: path buffer overrun",
+                              line_number + 1);
+        arena_shrink(&d->arena, DU_BUFFER_LENGTH - nchars);
         if (nchars == 0) {
-            entries = realloc(entries, n_entries * sizeof(entries[0]));
-            if (!entries) {
-                perror("realloc");
-                exit(1);
+            if (ferror(f))
+                return duvis_fail(d, DUVIS_EIO, "line %d: read error",
+                                  line_number + 1);
+            /* Don't keep the spare room. */
+            if (d->n_entries > 0) {
+                struct duvis_entry *entries =
+                    realloc(d->entries, d->n_entries * sizeof(entries[0]));
+                if (entries)
+                    d->entries = entries;
             }
-            return;
+            return DUVIS_OK;
         }
         line_number++;
         /* Allocate a new entry for the line. */
-        while (n_entries >= max_entries) {
+        while (d->n_entries >= max_entries) {
             if (max_entries == 0)
                 max_entries = DU_INIT_ENTRIES_SIZE;
             else
                 max_entries *= 2;
-            entries = realloc(entries, max_entries * sizeof(entries[0]));
-            if (!entries) {
-                perror("realloc");
-                exit(1);
-            }
+            struct duvis_entry *entries =
+                realloc(d->entries, max_entries * sizeof(entries[0]));
+            if (!entries)
+                return duvis_fail(d, DUVIS_ENOMEM,
+                                  "realloc: out of memory");
+            d->entries = entries;
         }
-        struct entry *entry = &entries[n_entries++];
+        struct duvis_entry *entry = &d->entries[d->n_entries++];
         entry->path = path;
         entry->n_children = 0;
         entry->children = 0;
@@ -75,28 +153,31 @@ static void read_entries(FILE *f, int zeroflag) {
         char *index = path;
         while (isdigit(*index))
             index++;
-        if (index == path || (*index != ' ' && *index != '\t')) {
-            fprintf(stderr, "line %d: buffer format error\n", line_number);
-            exit(1);
-        }
+        if (index == path || (*index != ' ' && *index != '\t'))
+            return duvis_fail(d, DUVIS_EFORMAT,
+                              "line %d: buffer format error", line_number);
         /* Parse the size field. */
         *index++ = '\0';
         int n_scanned = sscanf(path, "%" PRIu64, &entry->size);
-        if (n_scanned != 1) {
-            fprintf(stderr, "line %d: size parse failure\n", line_number);
-            exit(1);
-        }
+        if (n_scanned != 1)
+            return duvis_fail(d, DUVIS_EFORMAT,
+                              "line %d: size parse failure", line_number);
         /*
          * Parse the path. Note that we don't skip extra separator
          * chars, on the off chance that there's a leading path that
-         * starts with a whitespace character.
+         * starts with a whitespace character. Components are
+         * counted first so the array comes from the arena at
+         * its exact size.
          */
+        uint32_t n_components = 1;
+        for (char *s = index; *s != '\0'; s++)
+            if (*s == '/')
+                n_components++;
         entry->components =
-            malloc(DU_COMPONENTS_MAX * sizeof(entry->components[0]));
-        if (!entry->components) {
-            perror("malloc");
-            exit(1);
-        }
+            arena_alloc(&d->arena,
+                        n_components * sizeof(entry->components[0]));
+        if (!entry->components)
+            return duvis_fail(d, DUVIS_ENOMEM, "malloc: out of memory");
         /* This is a tricky little state machine for breaking
            the path into null-terminated components. */
         entry->components[0] = index;
@@ -109,19 +190,11 @@ static void read_entries(FILE *f, int zeroflag) {
             if (*index == '/') {
                 *index++ = '\0';
                 entry->components[entry->n_components++] = index;
-                assert(entry->n_components < DU_COMPONENTS_MAX);
                 continue;
             }
             index++;
         }
-        /* Don't leak a ton of data on each entry. */
-        entry->components =
-            realloc(entry->components,
-                    entry->n_components * sizeof(entry->components[0]));
-        if (!entry->components) {
-            perror("realloc");
-            exit(1);
-        }
+        assert(entry->n_components == n_components);
     }
     assert(0);
 }
@@ -132,8 +205,8 @@ static void read_entries(FILE *f, int zeroflag) {
  *   (2) Ascending alphabetical order.
  */
 static int compare_entries(const void *p1, const void * p2) {
-    const struct entry *e1 = p1;
-    const struct entry *e2 = p2;
+    const struct duvis_entry *e1 = p1;
+    const struct duvis_entry *e2 = p2;
     int n1 = e1->n_components;
     int n2 = e2->n_components;
     for (int i = 0; i < n1 && i < n2; i++) {
@@ -158,18 +231,18 @@ static int compare_sizes(uint32_t s1, uint32_t s2) {
  *   (1) Descending entry size.
  *   (2) Ascending alphabetical order.
  */
-static int compare_subtrees(const void *p1, const void * p2) {
-    struct entry * const *e1 = p1;
-    struct entry * const *e2 = p2;
+int duvis_compare_subtrees(const void *p1, const void * p2) {
+    struct duvis_entry * const *e1 = p1;
+    struct duvis_entry * const *e2 = p2;
     int s1 = (*e1)->size;
     int s2 = (*e2)->size;
     int q = compare_sizes(s2, s1);
     if (q != 0)
         return q;
     assert((*e1)->depth == (*e2)->depth);
-    int depth = (*e1)->depth;
-    q = strcmp((*e1)->components[depth + base_depth - 1],
-               (*e2)->components[depth + base_depth - 1]);
+    assert((*e1)->n_components == (*e2)->n_components);
+    int last = (*e1)->n_components - 1;
+    q = strcmp((*e1)->components[last], (*e2)->components[last]);
     return q;
 }
 
@@ -179,18 +252,17 @@ static int compare_subtrees(const void *p1, const void * p2) {
  * utilizes post-order traversal and takes advantage of the
  * existing du sorted output - assumes user wants du output
  */
-static void build_tree_postorder(uint32_t start, uint32_t end,
-                                 uint32_t depth) {
+static int build_tree_postorder(struct duvis *d, uint32_t start, uint32_t end,
+                                uint32_t depth) {
+    struct duvis_entry *entries = d->entries;
     uint32_t last = end - 1;
-    struct entry *e = &entries[last];
-    uint32_t offset = depth + base_depth;
-    assert(offset == e->n_components);
+    struct duvis_entry *e = &entries[last];
+    uint32_t offset = depth + d->base_depth;
 
     /* Set up some fields of e */
-    if(e->n_components != offset) {
-        fprintf(stderr, "line %d: unexpected entry\n", last + 1);
-        exit(1);
-    }
+    if(e->n_components != offset)
+        return duvis_fail(d, DUVIS_ETREE,
+                          "line %d: unexpected entry", last + 1);
     e->depth = depth;
 
     /* Count and allocate direct children */
@@ -198,14 +270,16 @@ static void build_tree_postorder(uint32_t start, uint32_t end,
     for (uint32_t i = start; i < last; i++) {
         if(entries[i].n_components == offset + 1) {
             if (strcmp(e->components[offset - 1],
-                       entries[i].components[offset - 1])) {
-                fprintf(stderr, "line %d: unexpected child\n", i + 1);
-                exit(1);
-            }
+                       entries[i].components[offset - 1]))
+                return duvis_fail(d, DUVIS_ETREE,
+                                  "line %d: unexpected child", i + 1);
             e->n_children++;
         }
     }
-    e->children = malloc(e->n_children * sizeof(e->children[0]));
+    e->children = arena_alloc(&d->arena,
+                              e->n_children * sizeof(e->children[0]));
+    if (!e->children)
+        return duvis_fail(d, DUVIS_ENOMEM, "malloc: out of memory");
 
     /* Fill direct children and build subtree */
     uint32_t n_children = 0;
@@ -219,34 +293,100 @@ static void build_tree_postorder(uint32_t start, uint32_t end,
             entries[i].n_children = 0;
             e->children[n_children++] = &entries[i];
             /* If this child has children, build that tree */
-            if (n_grandchildren > 0)
-                build_tree_postorder(i - n_grandchildren, i + 1, depth + 1);
+            if (n_grandchildren > 0) {
+                int result = build_tree_postorder(d, i - n_grandchildren,
+                                                  i + 1, depth + 1);
+                if (result)
+                    return result;
+            }
             n_grandchildren = 0;
             continue;
         }
-        if (entries[i].n_components <= offset + 1) {
-            fprintf(stderr, "line %d: unexpected grandchild\n", i + 1);
-            exit(1);
-        }
+        if (entries[i].n_components <= offset + 1)
+            return duvis_fail(d, DUVIS_ETREE,
+                              "line %d: unexpected grandchild", i + 1);
         n_grandchildren++;
     }
-    assert(n_grandchildren == 0);
+    if (n_grandchildren != 0)
+        return duvis_fail(d, DUVIS_ETREE,
+                          "line %d: unexpected grandchild", last + 1);
     assert(n_children == e->n_children);
+    return DUVIS_OK;
 }
 
 /*
- * Build a tree in the entry structure. The two-pass design
- * is for monotonic malloc() usage, because efficiency.
+ * Build a tree in the entry structure. The first pass
+ * counts the children, so each children array is one
+ * exact-size allocation from the building worker's arena.
+ * Sibling subtrees are independent, so runs of them are
+ * batched up and handed to the task pool. Errors are
+ * recorded in d, and stop any work not yet started.
+ */
+static void build_tree_preorder(struct duvis *d, int worker,
+                                uint32_t start, uint32_t end,
+                                uint32_t depth);
+
+/*
+ * A run of e's children, handed to a task. The children
+ * array already marks where each subtree starts, so the
+ * task needs only the end of the run's last subtree.
  */
-static void build_tree_preorder(uint32_t start, uint32_t end,
+struct child_run {
+    struct duvis *d;
+    struct duvis_entry *e;
+    uint32_t end;
+};
+
+/* Build the subtrees of e's children [first, last). */
+static void build_children(struct duvis *d, int worker, struct duvis_entry *e,
+                           uint32_t first, uint32_t last, uint32_t end) {
+    for (uint32_t k = first; k < last; k++) {
+        uint32_t i = e->children[k] - d->entries;
+        uint32_t j = k + 1 < last ? e->children[k + 1] - d->entries : end;
+        if (j > i + 1)
+            build_tree_preorder(d, worker, i, j, e->depth + 1);
+    }
+}
+
+static void build_children_task(struct duvis_task_pool *pool,
+                                int worker, void *arg,
+                                uint32_t start, uint32_t end) {
+    struct child_run *r = arg;
+    build_children(r->d, worker, r->e, start, end, r->end);
+}
+
+/* If the run can't be handed off, it is just built now. */
+static void spawn_children(struct duvis *d, int worker, struct duvis_entry *e,
+                           uint32_t first, uint32_t last, uint32_t end) {
+    struct child_run *r = duvis_task_alloc(d->pool, worker, sizeof(*r));
+    if (!r) {
+        build_children(d, worker, e, first, last, end);
+        return;
+    }
+    r->d = d;
+    r->e = e;
+    r->end = end;
+    duvis_task_spawn(d->pool, worker, build_children_task, r, first, last);
+}
+
+static void build_root_task(struct duvis_task_pool *pool, int worker,
+                            void *arg, uint32_t start, uint32_t end) {
+    build_tree_preorder(arg, worker, start, end, 0);
+}
+
+static void build_tree_preorder(struct duvis *d, int worker,
+                                uint32_t start, uint32_t end,
                                 uint32_t depth) {
-    
+    if (failed(d))
+        return;
+
     /* Set up for calculation. */
-    struct entry *e = &entries[start];
-    uint32_t offset = depth + base_depth;
+    struct duvis_entry *entries = d->entries;
+    struct duvis_entry *e = &entries[start];
+    uint32_t offset = depth + d->base_depth;
     if (e->n_components != offset) {
-        fprintf(stderr, "index %d: unexpected entry\n", start + 1);
-        exit(1);
+        duvis_fail(d, DUVIS_ETREE, "index %d: unexpected entry", start + 1);
+        return;
     }
     e->depth = depth;
 
@@ -254,19 +394,28 @@ static void build_tree_preorder(uint32_t start, uint32_t end,
     for (int i = start + 1; i < end; i++)
         if (entries[i].n_components == offset + 1)
             e->n_children++;
-    e->children = malloc(e->n_children * sizeof(e->children[0]));
+    e->children = duvis_task_alloc(d->pool, worker,
+                                   e->n_children * sizeof(e->children[0]));
     if (!e->children) {
-        perror("malloc");
-        exit(1);
+        duvis_fail(d, DUVIS_ENOMEM, "malloc: out of memory");
+        return;
     }
 
-    /* Pass 2: Fill direct children and build subtrees. */
+    /*
+     * Pass 2: Fill direct children and build subtrees. With
+     * threads, subtrees are collected into a batch of the
+     * children from batch on, starting at entry batch_start,
+     * which is spawned once it is big enough.
+     */
+    int parallel = d->n_threads > 1;
     int n_children = 0;
     int i = start + 1;
+    int batch = 0;
+    int batch_start = i;
     while (i < end) {
         if (entries[i].n_components != offset + 1) {
-            fprintf(stderr, "index %d: missing entry\n", i + 1);
-            exit(1);
+            duvis_fail(d, DUVIS_ETREE, "index %d: missing entry", i + 1);
+            return;
         }
         e->children[n_children++] = &entries[i];
         entries[i].depth = depth + 1;
@@ -276,63 +425,120 @@ static void build_tree_preorder(uint32_t start, uint32_t end,
                !strcmp(entries[i].components[offset],
                        entries[j].components[offset]))
             j++;
-        /* If subtree is found, build it. */
-        if (j > i + 1)
-            build_tree_preorder(i, j, depth + 1);
+        /* If subtree is found, build it, or batch it. */
+        if (!parallel) {
+            if (j > i + 1)
+                build_tree_preorder(d, worker, i, j, depth + 1);
+        } else if (j - batch_start >= TASK_MIN_ENTRIES) {
+            spawn_children(d, worker, e, batch, n_children, j);
+            batch = n_children;
+            batch_start = j;
+        }
         i = j;
     }
     assert(n_children == e->n_children);
+    if (parallel && batch < n_children)
+        build_children(d, worker, e, batch, n_children, end);
 }
 
-static void indent(uint32_t depth) {
+/*
+ * Sort (if preorder) and build the tree. The root is only
+ * recorded once the whole tree is built.
+ */
+int duvis_build(struct duvis *d, int preorder) {
+    if (d->status != DUVIS_OK)
+        return d->status;
+    if (d->n_entries == 0)
+        return duvis_fail(d, DUVIS_ESTATE, "no entries to build");
+    if (d->root_entry)
+        return duvis_fail(d, DUVIS_ESTATE, "tree already built");
+    if (preorder) {
+        qsort(d->entries, d->n_entries, sizeof(d->entries[0]),
+              compare_entries);
+        if (d->entries[0].n_components == 0)
+            return duvis_fail(d, DUVIS_EFORMAT,
+                              "Mysterious zero-length entry in table.");
+        d->base_depth = d->entries[0].n_components;
+        duvis_task_run(d->pool, build_root_task, d, 0, d->n_entries);
+        if (d->status != DUVIS_OK)
+            return d->status;
+        d->root_entry = &d->entries[0];
+        return DUVIS_OK;
+    }
+    d->base_depth = d->entries[d->n_entries - 1].n_components;
+    int result = build_tree_postorder(d, 0, d->n_entries, 0);
+    if (result != DUVIS_OK)
+        return result;
+    d->root_entry = &d->entries[d->n_entries - 1];
+    return DUVIS_OK;
+}
+
+static void indent(FILE *f, uint32_t depth) {
     for (uint64_t i = 0; i < N_INDENT * depth; i++)
-        putchar(' ');
+        putc(' ', f);
 }
 
-static void show_entries(struct entry *e) {
+static void show_entries(FILE *f, struct duvis_entry *e) {
     uint32_t depth = e->depth;
     if (depth == 0) {
-        printf("%s", e->components[0]);
-        for (uint32_t i = 1; i < base_depth; i++)
-            printf("/%s", e->components[i]);
-        printf(" %"PRIu64 "\n", e->size);
+        fprintf(f, "%s", e->components[0]);
+        for (uint32_t i = 1; i < e->n_components; i++)
+            fprintf(f, "/%s", e->components[i]);
+        fprintf(f, " %"PRIu64 "\n", e->size);
     }
     else {
-        indent(depth);
-        printf("%s %"PRIu64"\n",
-               e->components[e->n_components - 1], e->size);
+        indent(f, depth);
+        fprintf(f, "%s %"PRIu64"\n",
+                e->components[e->n_components - 1], e->size);
     }
     qsort(e->children, e->n_children, sizeof(e->children[0]),
-          compare_subtrees);
+          duvis_compare_subtrees);
     for (uint32_t i = 0; i < e->n_children; i++)
-        show_entries(e->children[i]);
+        show_entries(f, e->children[i]);
 }
 
-static void show_entries_raw(struct entry e[], int n) {
+int duvis_show(struct duvis *d, FILE *f) {
+    if (d->status != DUVIS_OK)
+        return d->status;
+    if (!d->root_entry)
+        return duvis_report(d, DUVIS_ESTATE, "tree not built");
+    show_entries(f, d->root_entry);
+    if (fflush(f) == EOF || ferror(f))
+        return duvis_report(d, DUVIS_EIO, "write error");
+    return DUVIS_OK;
+}
+
+static void show_entries_raw(FILE *f, struct duvis_entry e[], int n) {
     uint32_t depth = 0;
     uint32_t offset = 0;
 
     for(uint32_t i = 0; i < n; i++)
     {
 	depth = e[i].depth;
-	indent(depth);
+	indent(f, depth);
         offset = e[i].n_components - 1;
 
-	printf("%s %"PRIu64"\n", e[i].components[offset], e[i].size);
+	fprintf(f, "%s %"PRIu64"\n", e[i].components[offset], e[i].size);
     } 
 }
 
-static void status(char *msg) {
-    static int pass = 1;
-    fprintf(stderr, "(%d) %s\n", pass++, msg);
-} 
+int duvis_show_raw(struct duvis *d, FILE *f) {
+    if (d->status != DUVIS_OK)
+        return d->status;
+    if (!d->root_entry)
+        return duvis_report(d, DUVIS_ESTATE, "tree not built");
+    show_entries_raw(f, d->entries, d->n_entries);
+    if (fflush(f) == EOF || ferror(f))
+        return duvis_report(d, DUVIS_EIO, "write error");
+    return DUVIS_OK;
+}
 
 #ifdef DEBUG
 /*
  *  Helper/testing function for displaying detailed information 
  *  about the entries that have been read in from du.
  */
-static void dispEntryDetail (struct entry e[], int n) { 
+static void dispEntryDetail (struct duvis_entry e[], int n) { 
     printf("Detail of Entries\n# of Entries: %d\n\n", n);
 
     for(int i = 0; i < n; i++) {
@@ -359,7 +565,7 @@ static void dispEntryDetail (struct entry e[], int n) {
  *  that entries are currently in - formatted for directory
  *  view. Includes information about the size.
  */ 
-static void dispEntries(struct entry e[], int n) {
+static void dispEntries(struct duvis_entry e[], int n) {
     printf("Simple Entries\n# of Entries: %d\n\n", n);
 
     for(int i = 0; i < n; i++) {
@@ -373,116 +579,13 @@ static void dispEntries(struct entry e[], int n) {
 }
 #endif
 
-int find_max_depths(struct entry *e) {
+int duvis_find_max_depths(struct duvis_entry *e) {
     int max_depth = 0;
     for (int i = 0; i < e->n_children; i++) {
-        struct entry *c = e->children[i];
-        find_max_depths(c);
+        struct duvis_entry *c = e->children[i];
+        duvis_find_max_depths(c);
         if (c->max_depth > max_depth)
             max_depth = c->max_depth;
     }
     return max_depth + 1;
 }
-
-static char *iobuf;
-
-int main(int argc, char **argv) {
-
-    int c;
-    int pflag = 0, gflag = 0, rflag = 0, zeroflag = 0;
-    FILE *inf = stdin;
-
-    while((c = getopt(argc, argv, "pgr0")) != -1)
-    {
-	switch(c)
-	{
-	    case 'p':	// Enable pre-order sorting
-		pflag = 1;
-		break;
-	    case 'g':	// Enable GUI
-		gflag = 1;
-		break;
-	    case 'r':	// Enable GUI
-		rflag = 1;
-		break;
-	    case '0':	// Enable GUI
-		zeroflag = 1;
-		break;
-	    case '?':	// Error handling
-	        fprintf(stderr, "Unknown option -%c\n", optopt);
-	        exit(1);
-	    default:	// Something really weird happened
-		abort();
-	}
-    }
-    if (optind < argc) {
-        if (optind < argc - 1) {
-            fprintf(stderr, "extra argument(s)\n");
-            exit(1);
-        }
-        fprintf(stderr, "open %s\n", argv[optind]);
-        inf = fopen(argv[optind], "r");
-        if (!inf) {
-            perror("fopen");
-            exit(1);
-        }
-    }
-
-    // Set up for large IOs
-    iobuf = malloc(IO_BUFFER_LENGTH);
-    if (!iobuf) {
-        perror("malloc(iobuf)");
-        exit(1);
-    }
-    int result = setvbuf(inf, iobuf, _IOFBF, IO_BUFFER_LENGTH);
-    if (result) {
-        perror("setvbuf");
-        exit(1);
-    }
-
-    // Read in data from du
-    status("Parsing du file.");
-    read_entries(inf, zeroflag);
-
-    if (n_entries == 0)
-	return 0;
-
-    // default: post order
-    if(pflag == 0)
-    {
-    }
-    // pre order
-    if(pflag) {
-	status("Sorting entries.");
-	qsort(entries, n_entries, sizeof(entries[0]), compare_entries);
-	if(entries[0].n_components == 0) {
-	    fprintf(stderr, "Mysterious zero-length entry in table.\n");
-	    exit(1);
-        }
-
-	status("Building tree (preorder).");
-        root_entry = &entries[0];
-	base_depth = root_entry->n_components;
-	build_tree_preorder(0, n_entries, 0);
-    } else {
-	status("Building tree (postorder).");
-        root_entry = &entries[n_entries - 1];
-        base_depth = root_entry->n_components;
-	build_tree_postorder(0, n_entries, 0);
-    }
-
-    if (gflag) {
-        status("Recording depths.");
-        find_max_depths(root_entry);
-        status("Rendering tree.");
-        gui(argc, argv);
-    } else if (rflag) {
-        status("Emitting entries.");
-        show_entries_raw(entries, n_entries);
-    } else {
-        status("Emitting tree.");
-        show_entries(root_entry);
-    }
-    
-    return(0); 
-}
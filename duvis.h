@@ -5,17 +5,15 @@
  * distribution of this software for license terms.
  */ 
 
-/* Number of entries to consider "largest small". */
-#define DU_INIT_ENTRIES_SIZE (128 * 1024)
+/* Public interface of libduvis. */
 
-/* For portability. */
-#define DU_PATH_MAX 4096
-#define DU_COMPONENTS_MAX DU_PATH_MAX
+#ifndef DUVIS_H
+#define DUVIS_H
 
-/* Number of spaces of indent per level. */
-#define N_INDENT 2
+#include <stdint.h>
+#include <stdio.h>
 
-struct entry {
+struct duvis_entry {
     uint64_t size;		
     uint32_t n_components;    // # of components that makeup this entry
     char *path;               // for later free 
@@ -23,12 +21,48 @@ struct entry {
     uint32_t depth;	      // The depth of this entry in the directory tree
     uint32_t max_depth;	      // The depth of the tree at this entry
     uint32_t n_children;      // # of children directories at this entry level
-    struct entry **children;  // Children entries of this entry
+    struct duvis_entry **children; // Children entries of this entry
+    uint32_t n_entries;       // # of entries in the subtree at this entry
 };
 
-extern int n_entries;
-extern struct entry *entries;
-extern struct entry *root_entry;
-extern int base_depth;
+/* Formats for duvis_export(). */
+enum duvis_export_format {
+    DUVIS_EXPORT_NONE,
+    DUVIS_EXPORT_JSON,
+    DUVIS_EXPORT_CSV,
+    DUVIS_EXPORT_NCDU,
+    DUVIS_EXPORT_NCDU_FILES   // ncdu, leaves are files (du -a input)
+};
+
+/* Return codes of the library calls. */
+enum duvis_status {
+    DUVIS_OK = 0,
+    DUVIS_ENOMEM,             // out of memory
+    DUVIS_EIO,                // read or write failed
+    DUVIS_EFORMAT,            // du input is malformed
+    DUVIS_ETREE,              // du input is not a complete tree
+    DUVIS_ESTATE,             // call made out of order
+    DUVIS_EINVAL              // bad argument
+};
+
+/*
+ * One analysis of one du input. Separate analyses share
+ * nothing and can run on separate threads. After reading
+ * or building fails, later calls on the analysis just
+ * return the same status; a failed output call leaves the
+ * analysis usable.
+ */
+struct duvis;
+
+extern struct duvis *duvis_new(int n_threads);
+extern void duvis_free(struct duvis *d);
+extern int duvis_read(struct duvis *d, FILE *f, int zeroflag);
+extern int duvis_build(struct duvis *d, int preorder);
+extern int duvis_show(struct duvis *d, FILE *f);
+extern int duvis_show_raw(struct duvis *d, FILE *f);
+extern int duvis_export(struct duvis *d, FILE *f, int format);
+extern const char *duvis_error(struct duvis *d);
+extern int duvis_n_entries(struct duvis *d);
+extern struct duvis_entry *duvis_root(struct duvis *d);
 
-extern int gui(int argv, char **argc);
+#endif
@@ -0,0 +1,56 @@
+/*
+ * Copyright © 2014 Bart Massey
+ * [This program is licensed under the "MIT License"]
+ * Please see the file COPYING in the source
+ * distribution of this software for license terms.
+ */ 
+
+/*
+ * Internals shared by duvis sources; not part of the
+ * libduvis interface. Include after duvis.h.
+ */
+
+/* Number of entries to consider "largest small". */
+#define DU_INIT_ENTRIES_SIZE (128 * 1024)
+
+/* For portability. */
+#define DU_PATH_MAX 4096
+#define DU_COMPONENTS_MAX DU_PATH_MAX
+
+/* Number of spaces of indent per level. */
+#define N_INDENT 2
+
+/* Room for an error message in an analysis. */
+#define DU_ERROR_MAX 256
+
+/* Bump allocator; see pathmem.h. */
+struct duvis_arena {
+    char *block;              // current block, linked through its start
+    size_t n_block;           // bytes used in current block
+    size_t max_block;         // size of current block
+};
+
+/*
+ * Everything an analysis allocates is in its arenas, so
+ * duvis_free() is a handful of free() calls however big
+ * the input was.
+ */
+struct duvis {
+    int n_entries;
+    struct duvis_entry *entries;
+    struct duvis_entry *root_entry;
+    int base_depth;           // component length of initial prefix
+    int n_threads;
+    struct duvis_arena arena;
+    struct duvis_task_pool *pool;
+    int status;               // first error, or DUVIS_OK
+    char error[DU_ERROR_MAX];
+};
+
+extern int duvis_fail(struct duvis *d, int status, const char *fmt, ...);
+extern int duvis_report(struct duvis *d, int status, const char *fmt, ...);
+extern int duvis_compare_subtrees(const void *p1, const void *p2);
+extern int duvis_find_max_depths(struct duvis_entry *e);
+
+/* In graphics.c, which is only in the duvis program. */
+extern int gui(struct duvis *d, int argv, char **argc);
@@ -0,0 +1,494 @@
+/*
+ * Copyright © 2014 Bart Massey
+ * [This program is licensed under the "MIT License"]
+ * Please see the file COPYING in the source
+ * distribution of this software for license terms.
+ */
+
+/*
+ * Machine-readable tree export: nested JSON, flat CSV, and
+ * the ncdu export format. Output is written straight to a
+ * stdio stream. For big trees the output is cut into
+ * chunks in emit order. Chunks holding runs of whole
+ * subtrees are formatted in parallel into memory streams,
+ * a few at a time ahead of a writer that puts them out in
+ * order and frees each as soon as it is written.
+ */
+
+/* For open_memstream() and putc_unlocked(). */
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "duvis.h"
+#include "duvis_int.h"
+#include "tasks.h"
+
+/* ncdu wants bytes; du reports kB. */
+#define NCDU_BLOCK_SIZE 1024
+
+/* Chunks in flight per thread, between formatting and writing. */
+#define CHUNKS_AHEAD 4
+
+enum chunk_state {
+    CHUNK_WAITING,
+    CHUNK_BUSY,
+    CHUNK_DONE
+};
+
+struct chunk {
+    struct duvis_entry **run; // sibling subtrees, or 0 for fixed text
+    uint32_t n_run;
+    struct duvis_entry *e;    // fixed text is the head or tail of e
+    int tail;
+    int first;                // starts with the first of its siblings
+    int state;                // enum chunk_state, for runs
+    char *buf;
+    size_t n_buf;
+    struct export *x;
+};
+
+/* State of one export. */
+struct export {
+    struct duvis *d;
+    FILE *f;
+    int format;
+    struct chunk *chunks;
+    uint32_t n_chunks, max_chunks;
+    int status;               // first chunk error, or DUVIS_OK
+    const char *error;
+    pthread_mutex_t lock;     // for waiting on chunk states
+    pthread_cond_t done;
+};
+
+/* Record the subtree entry counts, for splitting up work. */
+static uint32_t count_entries(struct duvis_entry *e) {
+    uint32_t n = 1;
+    for (uint32_t i = 0; i < e->n_children; i++)
+        n += count_entries(e->children[i]);
+    e->n_entries = n;
+    return n;
+}
+
+/*
+ * Length of the valid UTF-8 sequence of two or more bytes
+ * at s, or 0 if there isn't one.
+ */
+static int utf8_length(const unsigned char *s) {
+    int n;
+    uint32_t min;
+    if (s[0] >= 0xc2 && s[0] <= 0xdf) {
+        n = 2;
+        min = 0x80;
+    } else if ((s[0] & 0xf0) == 0xe0) {
+        n = 3;
+        min = 0x800;
+    } else if (s[0] >= 0xf0 && s[0] <= 0xf4) {
+        n = 4;
+        min = 0x10000;
+    } else {
+        return 0;
+    }
+    uint32_t c = s[0] & (0x7f >> n);
+    for (int i = 1; i < n; i++) {
+        if ((s[i] & 0xc0) != 0x80)
+            return 0;
+        c = (c << 6) | (s[i] & 0x3f);
+    }
+    if (c < min || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+        return 0;
+    return n;
+}
+
+/*
+ * Paths need not be UTF-8, but JSON must be. A byte that
+ * isn't part of a valid UTF-8 sequence is written as the
+ * escape for the code point of the same value, so 0xff
+ * becomes \u00ff.
+ */
+static void put_json_string(FILE *f, const char *s) {
+    const unsigned char *u = (const unsigned char *) s;
+    while (*u) {
+        unsigned char ch = *u;
+        if (ch == '"' || ch == '\\') {
+            putc_unlocked('\\', f);
+            putc_unlocked(ch, f);
+        } else if (ch < 0x20) {
+            fprintf(f, "\\u%04x", ch);
+        } else if (ch < 0x80) {
+            putc_unlocked(ch, f);
+        } else {
+            int n = utf8_length(u);
+            if (n == 0) {
+                fprintf(f, "\\u%04x", ch);
+            } else {
+                fwrite(u, 1, n, f);
+                u += n;
+                continue;
+            }
+        }
+        u++;
+    }
+}
+
+/* The root is named by its whole path, others by last component. */
+static void put_json_name(FILE *f, struct duvis_entry *e) {
+    putc_unlocked('"', f);
+    if (e->depth == 0) {
+        put_json_string(f, e->components[0]);
+        for (uint32_t i = 1; i < e->n_components; i++) {
+            putc_unlocked('/', f);
+            put_json_string(f, e->components[i]);
+        }
+    } else {
+        put_json_string(f, e->components[e->n_components - 1]);
+    }
+    putc_unlocked('"', f);
+}
+
+/* Quote the path only if it needs it, per RFC 4180. */
+static void put_csv_path(FILE *f, struct duvis_entry *e) {
+    int quote = 0;
+    for (uint32_t i = 0; i < e->n_components && !quote; i++)
+        if (strpbrk(e->components[i], ",\"\r\n"))
+            quote = 1;
+    if (quote)
+        putc_unlocked('"', f);
+    for (uint32_t i = 0; i < e->n_components; i++) {
+        if (i > 0)
+            putc_unlocked('/', f);
+        for (const char *s = e->components[i]; *s; s++) {
+            if (*s == '"')
+                putc_unlocked('"', f);
+            putc_unlocked(*s, f);
+        }
+    }
+    if (quote)
+        putc_unlocked('"', f);
+}
+
+/* du sizes include the children; ncdu wants each item's own. */
+static uint64_t own_size(struct duvis_entry *e) {
+    uint64_t size = e->size;
+    for (uint32_t i = 0; i < e->n_children; i++) {
+        if (e->children[i]->size > size)
+            return 0;
+        size -= e->children[i]->size;
+    }
+    return size;
+}
+
+/*
+ * Entries without children can't be told apart from
+ * files. Plain du lists only directories, so for ncdu
+ * they are directories unless the input is from du -a.
+ */
+static int ncdu_dir(struct duvis_entry *e, int format) {
+    return e->n_children > 0 || e->depth == 0 || format == DUVIS_EXPORT_NCDU;
+}
+
+/* Text before an entry's children. */
+static void export_head(FILE *f, struct duvis_entry *e,
+                        int first, int format) {
+    switch (format) {
+    case DUVIS_EXPORT_JSON:
+        if (e->depth > 0) {
+            if (!first)
+                putc_unlocked(',', f);
+            putc_unlocked('\n', f);
+        }
+        fputs("{\"name\":", f);
+        put_json_name(f, e);
+        fprintf(f, ",\"size\":%" PRIu64, e->size);
+        if (e->n_children > 0)
+            fputs(",\"children\":[", f);
+        break;
+    case DUVIS_EXPORT_CSV:
+        put_csv_path(f, e);
+        fprintf(f, ",%" PRIu64 ",%" PRIu32 "\n", e->size, e->depth);
+        break;
+    case DUVIS_EXPORT_NCDU:
+    case DUVIS_EXPORT_NCDU_FILES:
+        putc_unlocked(',', f);
+        putc_unlocked('\n', f);
+        if (ncdu_dir(e, format))
+            putc_unlocked('[', f);
+        fputs("{\"name\":", f);
+        put_json_name(f, e);
+        fprintf(f, ",\"dsize\":%" PRIu64 "}", own_size(e) * NCDU_BLOCK_SIZE);
+        break;
+    default:
+        abort();
+    }
+}
+
+/* Text after an entry's children. */
+static void export_tail(FILE *f, struct duvis_entry *e, int format) {
+    switch (format) {
+    case DUVIS_EXPORT_JSON:
+        if (e->n_children > 0)
+            putc_unlocked(']', f);
+        putc_unlocked('}', f);
+        break;
+    case DUVIS_EXPORT_NCDU:
+    case DUVIS_EXPORT_NCDU_FILES:
+        if (ncdu_dir(e, format))
+            putc_unlocked(']', f);
+        break;
+    }
+}
+
+static void export_subtree(FILE *f, struct duvis_entry *e,
+                           int first, int format) {
+    export_head(f, e, first, format);
+    if (e->n_children > 1)
+        qsort(e->children, e->n_children, sizeof(e->children[0]),
+              duvis_compare_subtrees);
+    for (uint32_t i = 0; i < e->n_children; i++)
+        export_subtree(f, e->children[i], i == 0, format);
+    export_tail(f, e, format);
+}
+
+/*
+ * Record a chunk error. Like duvis_fail(), only the first
+ * sticks, but just for this export.
+ */
+static void export_fail(struct export *x, int status, const char *error) {
+    int ok = DUVIS_OK;
+    if (__atomic_compare_exchange_n(&x->status, &ok, status, 0,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        x->error = error;
+}
+
+static int export_failed(struct export *x) {
+    return __atomic_load_n(&x->status, __ATOMIC_SEQ_CST) != DUVIS_OK;
+}
+
+/* Returns 0 after recording an error. */
+static FILE *chunk_open(struct chunk *c) {
+    FILE *f = open_memstream(&c->buf, &c->n_buf);
+    if (!f) {
+        export_fail(c->x, DUVIS_ENOMEM, "open_memstream: out of memory");
+        return 0;
+    }
+    flockfile(f);
+    return f;
+}
+
+static void chunk_close(struct chunk *c, FILE *f) {
+    funlockfile(f);
+    if (fclose(f) == EOF)
+        export_fail(c->x, DUVIS_EIO, "fclose: memory stream write failed");
+}
+
+/* Returns 0 after recording an error. */
+static struct chunk *chunk_new(struct export *x, struct duvis_entry **run,
+                               uint32_t n_run, int first) {
+    if (x->n_chunks >= x->max_chunks) {
+        uint32_t max_chunks = x->max_chunks ? 2 * x->max_chunks : 64;
+        struct chunk *chunks =
+            realloc(x->chunks, max_chunks * sizeof(chunks[0]));
+        if (!chunks) {
+            export_fail(x, DUVIS_ENOMEM, "realloc: out of memory");
+            return 0;
+        }
+        x->chunks = chunks;
+        x->max_chunks = max_chunks;
+    }
+    struct chunk *c = &x->chunks[x->n_chunks++];
+    c->run = run;
+    c->n_run = n_run;
+    c->e = 0;
+    c->tail = 0;
+    c->first = first;
+    c->state = CHUNK_WAITING;
+    c->buf = 0;
+    c->n_buf = 0;
+    c->x = x;
+    return c;
+}
+
+/* Fixed text is small, so the writer just formats it in place. */
+static int chunk_fixed(struct export *x, struct duvis_entry *e,
+                       int first, int tail) {
+    struct chunk *c = chunk_new(x, 0, 0, first);
+    if (!c)
+        return -1;
+    c->e = e;
+    c->tail = tail;
+    return 0;
+}
+
+/*
+ * Cut the big entry e into chunks in emit order. Runs of
+ * small sibling subtrees are gathered into chunks of up to
+ * about TASK_MIN_ENTRIES; big children are cut up in turn,
+ * between fixed chunks for the head and tail of e.
+ */
+static int plan_chunks(struct export *x, struct duvis_entry *e, int first) {
+    if (chunk_fixed(x, e, first, 0))
+        return -1;
+    if (e->n_children > 1)
+        qsort(e->children, e->n_children, sizeof(e->children[0]),
+              duvis_compare_subtrees);
+    uint32_t run = 0;
+    uint32_t n_run_entries = 0;
+    for (uint32_t i = 0; i <= e->n_children; i++) {
+        struct duvis_entry *c = i < e->n_children ? e->children[i] : 0;
+        int big = c && c->n_entries >= TASK_MIN_ENTRIES;
+        /* Close off the run before a big child, at the end,
+           or when it is big enough. */
+        if (run < i && (!c || big ||
+                        n_run_entries + c->n_entries > TASK_MIN_ENTRIES)) {
+            if (!chunk_new(x, &e->children[run], i - run, run == 0))
+                return -1;
+            run = i;
+            n_run_entries = 0;
+        }
+        if (big) {
+            if (plan_chunks(x, c, i == 0))
+                return -1;
+            run = i + 1;
+        } else if (c) {
+            n_run_entries += c->n_entries;
+        }
+    }
+    return chunk_fixed(x, e, 0, 1);
+}
+
+/* Format a run chunk, unless somebody else already is. */
+static void export_chunk(struct chunk *c) {
+    int waiting = CHUNK_WAITING;
+    if (!__atomic_compare_exchange_n(&c->state, &waiting, CHUNK_BUSY, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        return;
+    FILE *f = chunk_open(c);
+    if (f) {
+        for (uint32_t i = 0; i < c->n_run; i++)
+            export_subtree(f, c->run[i], c->first && i == 0, c->x->format);
+        chunk_close(c, f);
+    }
+    pthread_mutex_lock(&c->x->lock);
+    __atomic_store_n(&c->state, CHUNK_DONE, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&c->x->done);
+    pthread_mutex_unlock(&c->x->lock);
+}
+
+static void export_chunk_task(struct duvis_task_pool *pool,
+                              int worker, void *arg,
+                              uint32_t start, uint32_t end) {
+    export_chunk(arg);
+}
+
+/*
+ * Write the chunks out in order, keeping a few ahead in
+ * the works. A chunk nobody has started yet is formatted
+ * here rather than waited for, so the writer never waits
+ * on a task that is only queued.
+ */
+static void export_writer_task(struct duvis_task_pool *pool,
+                               int worker, void *arg,
+                               uint32_t start, uint32_t end) {
+    struct export *x = arg;
+    FILE *f = x->f;
+    uint32_t n_ahead = CHUNKS_AHEAD * x->d->n_threads;
+    uint32_t next = 0;
+    flockfile(f);
+    for (uint32_t i = 0; i < x->n_chunks; i++) {
+        for (; next < x->n_chunks && next < i + n_ahead; next++)
+            if (x->chunks[next].run)
+                duvis_task_spawn(pool, worker, export_chunk_task,
+                                 &x->chunks[next], 0, 0);
+        struct chunk *c = &x->chunks[i];
+        if (!c->run) {
+            if (export_failed(x))
+                continue;
+            if (c->tail)
+                export_tail(f, c->e, x->format);
+            else
+                export_head(f, c->e, c->first, x->format);
+            continue;
+        }
+        export_chunk(c);
+        pthread_mutex_lock(&x->lock);
+        while (__atomic_load_n(&c->state, __ATOMIC_SEQ_CST) != CHUNK_DONE)
+            pthread_cond_wait(&x->done, &x->lock);
+        pthread_mutex_unlock(&x->lock);
+        if (!export_failed(x))
+            fwrite(c->buf, 1, c->n_buf, f);
+        free(c->buf);
+        c->buf = 0;
+    }
+    funlockfile(f);
+}
+
+/*
+ * Format big trees in parallel, writing them out as we go.
+ * Returns the first chunk error, or DUVIS_OK.
+ */
+static int export_parallel(struct export *x) {
+    pthread_mutex_init(&x->lock, 0);
+    pthread_cond_init(&x->done, 0);
+    if (!plan_chunks(x, x->d->root_entry, 1))
+        duvis_task_run(x->d->pool, export_writer_task, x, 0, 0);
+    pthread_mutex_destroy(&x->lock);
+    pthread_cond_destroy(&x->done);
+    free(x->chunks);
+    if (x->status != DUVIS_OK)
+        return duvis_report(x->d, x->status, "%s", x->error);
+    return DUVIS_OK;
+}
+
+int duvis_export(struct duvis *d, FILE *f, int format) {
+    struct duvis_entry *root = d->root_entry;
+    if (d->status != DUVIS_OK)
+        return d->status;
+    if (!root)
+        return duvis_report(d, DUVIS_ESTATE, "tree not built");
+    if (format != DUVIS_EXPORT_JSON && format != DUVIS_EXPORT_CSV &&
+        format != DUVIS_EXPORT_NCDU && format != DUVIS_EXPORT_NCDU_FILES)
+        return duvis_report(d, DUVIS_EINVAL, "unknown export format %d",
+                            format);
+
+    switch (format) {
+    case DUVIS_EXPORT_CSV:
+        fputs("path,size,depth\n", f);
+        break;
+    case DUVIS_EXPORT_NCDU:
+    case DUVIS_EXPORT_NCDU_FILES:
+        fprintf(f, "[1,0,{\"progname\":\"duvis\",\"progver\":\"1.0\","
+                "\"timestamp\":%" PRIu64 "}", (uint64_t) time(0));
+        break;
+    }
+
+    count_entries(root);
+    if (d->n_threads > 1 && root->n_entries >= TASK_MIN_ENTRIES) {
+        /* The writer may be any worker, so it locks f itself. */
+        struct export x = { .d = d, .f = f, .format = format };
+        int status = export_parallel(&x);
+        if (status != DUVIS_OK)
+            return status;
+    } else {
+        flockfile(f);
+        export_subtree(f, root, 1, format);
+        funlockfile(f);
+    }
+
+    switch (format) {
+    case DUVIS_EXPORT_JSON:
+        putc('\n', f);
+        break;
+    case DUVIS_EXPORT_NCDU:
+    case DUVIS_EXPORT_NCDU_FILES:
+        fputs("]\n", f);
+        break;
+    }
+    if (fflush(f) == EOF || ferror(f))
+        return duvis_report(d, DUVIS_EIO, "write error");
+    return DUVIS_OK;
+}
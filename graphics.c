@@ -11,10 +11,14 @@
 #include <gtk/gtk.h>
 
 #include "duvis.h"
+#include "duvis_int.h"
 
 static int display_width, display_height;
 
-static void draw_node(cairo_t *cr, struct entry *e,
+/* The analysis being shown. */
+static struct duvis *analysis;
+
+static void draw_node(cairo_t *cr, struct duvis_entry *e,
                       int x, int y, int width, int height) {
 
     /* Length of 2**64 - 1, +1 for null */
@@ -34,7 +38,7 @@ static void draw_node(cairo_t *cr, struct entry *e,
     cairo_move_to(cr, txtX, txtY);
     if (e->depth == 0) {
         cairo_show_text(cr, e->components[0]);
-        for (int i = 1; i < base_depth; i++) {
+        for (uint32_t i = 1; i < e->n_components; i++) {
             cairo_show_text(cr, "/");
             cairo_show_text(cr, e->components[i]);
         }
@@ -46,7 +50,7 @@ static void draw_node(cairo_t *cr, struct entry *e,
     cairo_show_text(cr, ")");
 }
 
-static void draw_tree(cairo_t *cr, struct entry *e) {
+static void draw_tree(cairo_t *cr, struct duvis_entry *e) {
     draw_node(cr, e, 0, 0, display_width, display_height);
 }
 
@@ -71,7 +75,7 @@ static void do_drawing(GtkWidget *widget, cairo_t *cr) {
     cairo_set_line_join(cr, CAIRO_LINE_JOIN_MITER);
     
     /* Begin drawing the nodes */
-    draw_tree(cr, root_entry);
+    draw_tree(cr, duvis_root(analysis));
 }
 
 /* Call up the cairo functionality */
@@ -91,11 +95,13 @@ static void getSize(GtkWidget *widget,
 }
 
 /* Initialize the window, drawing surface, and functionality */
-int gui(int argv, char **argc) {
+int gui(struct duvis *d, int argv, char **argc) {
 
     GtkWidget *window;
     GtkWidget *darea;
 
+    analysis = d;
+
     /* Initialize GTK, the window, and the drawing surface */
     gtk_init(&argv, &argc); 
     window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
@@ -0,0 +1,162 @@
+/*
+ * Copyright © 2014 Bart Massey
+ * [This program is licensed under the "MIT License"]
+ * Please see the file COPYING in the source
+ * distribution of this software for license terms.
+ */ 
+   
+/* Command-line driver for the duvis library. */
+
+/* For sysconf(_SC_NPROCESSORS_ONLN). */
+#define _GNU_SOURCE
+ 
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* For command line variables */
+#include <getopt.h>
+
+#include "duvis.h"
+#include "duvis_int.h"
+
+#define IO_BUFFER_LENGTH (1024 * 1024)
+
+static void status(char *msg) {
+    static int pass = 1;
+    fprintf(stderr, "(%d) %s\n", pass++, msg);
+}
+
+static void fail(struct duvis *d) {
+    fprintf(stderr, "%s\n", duvis_error(d));
+    exit(1);
+}
+
+static char *iobuf;
+
+int main(int argc, char **argv) {
+
+    int c;
+    int pflag = 0, gflag = 0, rflag = 0, zeroflag = 0;
+    int eformat = DUVIS_EXPORT_NONE;
+    int n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    FILE *inf = stdin;
+    struct duvis *d;
+
+    while((c = getopt(argc, argv, "pgr0j:e:")) != -1)
+    {
+	switch(c)
+	{
+	    case 'p':	// Enable pre-order sorting
+		pflag = 1;
+		break;
+	    case 'g':	// Enable GUI
+		gflag = 1;
+		break;
+	    case 'r':	// Enable GUI
+		rflag = 1;
+		break;
+	    case '0':	// Enable GUI
+		zeroflag = 1;
+		break;
+	    case 'j':	// Number of tree-building threads
+		n_threads = atoi(optarg);
+		if (n_threads < 1) {
+		    fprintf(stderr, "bad thread count %s\n", optarg);
+		    exit(1);
+		}
+		break;
+	    case 'e':	// Export in a machine-readable format
+		if (!strcmp(optarg, "json"))
+		    eformat = DUVIS_EXPORT_JSON;
+		else if (!strcmp(optarg, "csv"))
+		    eformat = DUVIS_EXPORT_CSV;
+		else if (!strcmp(optarg, "ncdu"))
+		    eformat = DUVIS_EXPORT_NCDU;
+		else if (!strcmp(optarg, "ncdu-a"))
+		    eformat = DUVIS_EXPORT_NCDU_FILES;
+		else {
+		    fprintf(stderr, "unknown export format %s\n", optarg);
+		    exit(1);
+		}
+		break;
+	    case '?':	// Error handling
+	        fprintf(stderr, "Unknown option -%c\n", optopt);
+	        exit(1);
+	    default:	// Something really weird happened
+		abort();
+	}
+    }
+    if (optind < argc) {
+        if (optind < argc - 1) {
+            fprintf(stderr, "extra argument(s)\n");
+            exit(1);
+        }
+        fprintf(stderr, "open %s\n", argv[optind]);
+        inf = fopen(argv[optind], "r");
+        if (!inf) {
+            perror("fopen");
+            exit(1);
+        }
+    }
+
+    // Set up for large IOs
+    iobuf = malloc(IO_BUFFER_LENGTH);
+    if (!iobuf) {
+        perror("malloc(iobuf)");
+        exit(1);
+    }
+    int result = setvbuf(inf, iobuf, _IOFBF, IO_BUFFER_LENGTH);
+    if (result) {
+        perror("setvbuf");
+        exit(1);
+    }
+
+    d = duvis_new(n_threads);
+    if (!d) {
+        perror("duvis_new");
+        exit(1);
+    }
+
+    // Read in data from du
+    status("Parsing du file.");
+    if (duvis_read(d, inf, zeroflag))
+        fail(d);
+
+    if (duvis_n_entries(d) == 0) {
+        duvis_free(d);
+	return 0;
+    }
+
+    if(pflag) {
+	status("Sorting and building tree (preorder).");
+    } else {
+	status("Building tree (postorder).");
+    }
+    if (duvis_build(d, pflag))
+        fail(d);
+
+    if (gflag) {
+        status("Recording depths.");
+        duvis_find_max_depths(duvis_root(d));
+        status("Rendering tree.");
+        gui(d, argc, argv);
+    } else if (eformat != DUVIS_EXPORT_NONE) {
+        status("Exporting tree.");
+        if (duvis_export(d, stdout, eformat))
+            fail(d);
+    } else if (rflag) {
+        status("Emitting entries.");
+        if (duvis_show_raw(d, stdout))
+            fail(d);
+    } else {
+        status("Emitting tree.");
+        if (duvis_show(d, stdout))
+            fail(d);
+    }
+
+    duvis_free(d);
+    return(0); 
+}
@@ -15,9 +15,16 @@
 #define DU_BUFFER_LENGTH (17 + 1 + (2 + DU_PATH_MAX) + 1)
 #define MAX_PATH_BUFFER (1024 * DU_BUFFER_LENGTH)
 
-static char *path_buffer = 0;
-static uint64_t n_path_buffer = 0;
+/* Every block starts with a link to the block before. */
+#define ARENA_HEADER sizeof(char *)
 
+/* Alignment of arena allocations. */
+#define ARENA_ALIGN sizeof(void *)
+
+/*
+ * Read a path into the buffer. Returns the number of
+ * bytes consumed, 0 at EOF or -1 on overrun.
+ */
 static inline int path_get(char *path, int npath, FILE *f, int zeroflag) {
     int nread = 0;
     while (1) {
@@ -25,8 +32,8 @@ static inline int path_get(char *path, int npath, FILE *f, int zeroflag) {
             return -1;
         int ch = fgetc(f);
         if (ch == EOF) {
+            /* Accept an unterminated final path. */
             if (nread > 0) {
-                fprintf(stderr, "warning: unterminated final path\n");
                 nread++;
                 break;
             }
@@ -38,26 +45,40 @@ static inline int path_get(char *path, int npath, FILE *f, int zeroflag) {
         *path++ = ch;
     }
     *path = '\0';
-    n_path_buffer -= DU_BUFFER_LENGTH - nread;
     return nread;
 }
 
-static inline char *path_alloc() {
-    if (!path_buffer || n_path_buffer + DU_BUFFER_LENGTH > MAX_PATH_BUFFER) {
-        path_buffer = malloc(MAX_PATH_BUFFER);
-        if (!path_buffer) {
-            perror("malloc");
-            exit(1);
-        }
-        n_path_buffer = 0;
+/* Returns 0 when out of memory. */
+static inline void *arena_alloc(struct duvis_arena *a, size_t size) {
+    size_t n_block = (a->n_block + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (!a->block || n_block + size > a->max_block) {
+        size_t max_block = MAX_PATH_BUFFER;
+        if (size + ARENA_HEADER > max_block)
+            max_block = size + ARENA_HEADER;
+        char *block = malloc(max_block);
+        if (!block)
+            return 0;
+        *(char **) block = a->block;
+        a->block = block;
+        a->max_block = max_block;
+        n_block = ARENA_HEADER;
     }
-    char *result = &path_buffer[n_path_buffer];
-    n_path_buffer += DU_BUFFER_LENGTH;
+    char *result = &a->block[n_block];
+    a->n_block = n_block + size;
     return result;
 }
 
-/* Don't leak spare portion of last block */
-static inline void path_cleanup() {
-    if (path_buffer)
-        path_buffer = realloc(path_buffer, n_path_buffer);
+/* Give back the unused tail of the latest allocation. */
+static inline void arena_shrink(struct duvis_arena *a, size_t unused) {
+    a->n_block -= unused;
+}
+
+static inline void arena_free(struct duvis_arena *a) {
+    while (a->block) {
+        char *prev = *(char **) a->block;
+        free(a->block);
+        a->block = prev;
+    }
+    a->n_block = 0;
+    a->max_block = 0;
 }
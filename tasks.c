@@ -0,0 +1,224 @@
+/*
+ * Copyright © 2014 Bart Massey
+ * [This program is licensed under the "MIT License"]
+ * Please see the file COPYING in the source
+ * distribution of this software for license terms.
+ */
+
+/*
+ * Work-stealing task pool. Each worker owns a deque: it
+ * pushes and pops its own tasks at the bottom, and idle
+ * workers steal from the top of somebody else's, which
+ * tends to hand out the biggest ranges first.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "duvis.h"
+#include "duvis_int.h"
+#include "pathmem.h"
+#include "tasks.h"
+
+struct task {
+    task_fn fn;
+    void *arg;
+    uint32_t start, end;
+};
+
+struct deque {
+    pthread_mutex_t lock;
+    struct task *tasks;
+    uint32_t top, bottom;     // live tasks are [top, bottom)
+    uint32_t max_tasks;
+};
+
+struct duvis_task_pool {
+    int n_workers;
+    struct deque *deques;
+    struct duvis_arena *arenas;
+    /* Tasks spawned but not yet finished, and not yet started. */
+    uint32_t n_pending;
+    uint32_t n_queued;
+    uint32_t n_sleeping;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+};
+
+/* Returns 0 when out of memory. */
+struct duvis_task_pool *duvis_task_pool_new(int n_workers) {
+    if (n_workers < 1)
+        n_workers = 1;
+    struct duvis_task_pool *pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        return 0;
+    pool->n_workers = n_workers;
+    pool->deques = calloc(n_workers, sizeof(pool->deques[0]));
+    pool->arenas = calloc(n_workers, sizeof(pool->arenas[0]));
+    if (!pool->deques || !pool->arenas) {
+        free(pool->deques);
+        free(pool->arenas);
+        free(pool);
+        return 0;
+    }
+    for (int i = 0; i < n_workers; i++)
+        pthread_mutex_init(&pool->deques[i].lock, 0);
+    pthread_mutex_init(&pool->idle_lock, 0);
+    pthread_cond_init(&pool->idle_cond, 0);
+    return pool;
+}
+
+/* Also frees everything handed out by duvis_task_alloc(). */
+void duvis_task_pool_free(struct duvis_task_pool *pool) {
+    if (!pool)
+        return;
+    for (int i = 0; i < pool->n_workers; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+        arena_free(&pool->arenas[i]);
+    }
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle_cond);
+    free(pool->deques);
+    free(pool->arenas);
+    free(pool);
+}
+
+/* If the task can't be queued, it is just run now. */
+void duvis_task_spawn(struct duvis_task_pool *pool, int worker,
+                      task_fn fn, void *arg, uint32_t start, uint32_t end) {
+    struct deque *d = &pool->deques[worker];
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom >= d->max_tasks) {
+        uint32_t max_tasks = d->max_tasks ? 2 * d->max_tasks : 64;
+        struct task *tasks =
+            realloc(d->tasks, max_tasks * sizeof(d->tasks[0]));
+        if (!tasks) {
+            pthread_mutex_unlock(&d->lock);
+            fn(pool, worker, arg, start, end);
+            return;
+        }
+        d->tasks = tasks;
+        d->max_tasks = max_tasks;
+    }
+    __atomic_add_fetch(&pool->n_pending, 1, __ATOMIC_SEQ_CST);
+    struct task *t = &d->tasks[d->bottom++];
+    t->fn = fn;
+    t->arg = arg;
+    t->start = start;
+    t->end = end;
+    pthread_mutex_unlock(&d->lock);
+    /* Pairs with the sleeper's check in worker_loop(). */
+    __atomic_add_fetch(&pool->n_queued, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->n_sleeping, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->idle_lock);
+        pthread_cond_signal(&pool->idle_cond);
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+}
+
+/* Take from the bottom of our own deque, else the top of another's. */
+static int task_take(struct duvis_task_pool *pool, int worker,
+                     struct task *t) {
+    int n_workers = pool->n_workers;
+    for (int k = 0; k < n_workers; k++) {
+        struct deque *d = &pool->deques[(worker + k) % n_workers];
+        pthread_mutex_lock(&d->lock);
+        if (d->top < d->bottom) {
+            if (k == 0)
+                *t = d->tasks[--d->bottom];
+            else
+                *t = d->tasks[d->top++];
+            if (d->top == d->bottom)
+                d->top = d->bottom = 0;
+            pthread_mutex_unlock(&d->lock);
+            __atomic_sub_fetch(&pool->n_queued, 1, __ATOMIC_SEQ_CST);
+            return 1;
+        }
+        pthread_mutex_unlock(&d->lock);
+    }
+    return 0;
+}
+
+static void worker_loop(struct duvis_task_pool *pool, int worker) {
+    struct task t;
+    while (1) {
+        if (task_take(pool, worker, &t)) {
+            t.fn(pool, worker, t.arg, t.start, t.end);
+            if (__atomic_sub_fetch(&pool->n_pending, 1,
+                                   __ATOMIC_SEQ_CST) == 0) {
+                pthread_mutex_lock(&pool->idle_lock);
+                pthread_cond_broadcast(&pool->idle_cond);
+                pthread_mutex_unlock(&pool->idle_lock);
+            }
+            continue;
+        }
+        pthread_mutex_lock(&pool->idle_lock);
+        __atomic_add_fetch(&pool->n_sleeping, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&pool->n_pending, __ATOMIC_SEQ_CST) == 0) {
+            __atomic_sub_fetch(&pool->n_sleeping, 1, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&pool->idle_lock);
+            return;
+        }
+        if (__atomic_load_n(&pool->n_queued, __ATOMIC_SEQ_CST) == 0)
+            pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+        __atomic_sub_fetch(&pool->n_sleeping, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+}
+
+struct worker_start {
+    struct duvis_task_pool *pool;
+    int worker;
+};
+
+static void *worker_thread(void *p) {
+    struct worker_start *w = p;
+    worker_loop(w->pool, w->worker);
+    return 0;
+}
+
+/*
+ * Run fn on [start, end) and everything it spawns, using
+ * all the workers. The calling thread is worker 0. Returns
+ * when every task has finished. Workers that can't be
+ * started just leave more for the others.
+ */
+void duvis_task_run(struct duvis_task_pool *pool, task_fn fn, void *arg,
+                    uint32_t start, uint32_t end) {
+    int n_threads = pool->n_workers - 1;
+    pthread_t *threads = 0;
+    struct worker_start *starts = 0;
+    if (n_threads > 0) {
+        threads = malloc(n_threads * sizeof(threads[0]));
+        starts = malloc(n_threads * sizeof(starts[0]));
+        if (!threads || !starts)
+            n_threads = 0;
+    }
+    duvis_task_spawn(pool, 0, fn, arg, start, end);
+    int n_started = 0;
+    for (; n_started < n_threads; n_started++) {
+        starts[n_started].pool = pool;
+        starts[n_started].worker = n_started + 1;
+        if (pthread_create(&threads[n_started], 0, worker_thread,
+                           &starts[n_started]))
+            break;
+    }
+    worker_loop(pool, 0);
+    for (int i = 0; i < n_started; i++)
+        pthread_join(threads[i], 0);
+    free(threads);
+    free(starts);
+}
+
+/*
+ * Per-worker bump allocator. Nothing is freed before
+ * duvis_task_pool_free(); this is for long-lived tree
+ * data, where it saves contending on the malloc() lock.
+ * Returns 0 when out of memory.
+ */
+void *duvis_task_alloc(struct duvis_task_pool *pool, int worker, size_t size) {
+    return arena_alloc(&pool->arenas[worker], size);
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright © 2014 Bart Massey
+ * [This program is licensed under the "MIT License"]
+ * Please see the file COPYING in the source
+ * distribution of this software for license terms.
+ */
+
+/* Work-stealing task pool. */
+
+/* Smallest entry range worth handing to another worker. */
+#define TASK_MIN_ENTRIES (16 * 1024)
+
+struct duvis_task_pool;
+
+/*
+ * A task covers the entry range [start, end). The worker
+ * index is passed in so that tasks can use per-worker state
+ * such as duvis_task_alloc().
+ */
+typedef void (*task_fn)(struct duvis_task_pool *pool, int worker,
+                        void *arg, uint32_t start, uint32_t end);
+
+extern struct duvis_task_pool *duvis_task_pool_new(int n_workers);
+extern void duvis_task_pool_free(struct duvis_task_pool *pool);
+extern void duvis_task_spawn(struct duvis_task_pool *pool, int worker,
+                             task_fn fn, void *arg,
+                             uint32_t start, uint32_t end);
+extern void duvis_task_run(struct duvis_task_pool *pool, task_fn fn,
+                           void *arg, uint32_t start, uint32_t end);
+extern void *duvis_task_alloc(struct duvis_task_pool *pool, int worker,
+                              size_t size);